@@ -30,8 +30,24 @@
 #include <memory.h>
 
 #include "Pixelmap32.h"
+#include "Pixelmap32Tuning.h"
 
-#define DOWN_NBITS 11
+#define DOWN_NBITS PIXELMAP32_DOWN_NBITS
+
+#define RUN_COLUMNS 64 // width of the line pieces ScaleDownY compares to find vertical runs
+
+// Where a pass's rectangles sit along the axis it scales. The destination rectangle may be a
+// window of a longer (virtual) destination; the pass then starts at the DDA phase a pass over
+// the whole span would have there, so windows of one span tile it without seams.
+typedef struct {
+	int32_t lSrcLen; // whole source span
+	int32_t lDstLen; // whole destination span
+	int32_t lDstOff; // first destination pixel written, from the start of the span
+	int32_t lSrcOff; // first source pixel in the source rectangle, from the start of the span
+} ScaleSpan;
+
+typedef void (*ScalePass)(Pixelmap32 *pDstPm, Rectangle *pDstRc, Pixelmap32 *pSrcPm, Rectangle *pSrcRc,
+	uint32_t ulFlags, Pixelmap32Stats *pStats, ScaleSpan *pSpan);
 
 /*--------------------------------------------------------------------------------------------------------------------*/
 static int32_t RectangleDx(Rectangle *pRc)
@@ -69,16 +85,29 @@ static int RectangleIsNull(Rectangle *pRc)
 	return 0;
 }
 
+/*--------------------------------------------------------------------------------------------------------------------*/
+static int Pixelmap32Bytes(uint32_t dx, uint32_t dy, size_t *pBytes)
+{// false if dx x dy pixels do not fit in a size_t
+    if (dy != 0 && dx > ((SIZE_MAX / sizeof(BGRA32)) / dy))
+        return 0;
+    *pBytes = ((size_t)dx * dy * sizeof(BGRA32));
+    return !0;
+}
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 Pixelmap32 *NewPixelmap32(uint32_t dx, uint32_t dy)
 {
+	size_t bytes;
+	if (!Pixelmap32Bytes(dx, dy, &bytes))
+		return NULL;
+
 	Pixelmap32 *pPm = (Pixelmap32*)calloc(1, sizeof(Pixelmap32));
 	if (pPm != NULL)
 	{
 		pPm->dx = dx;
 		pPm->dy = dy;
 		if (dx > 0 && dy > 0) {
-			pPm->p_data = malloc(dx * dy * sizeof(BGRA32));
+			pPm->p_data = malloc(bytes);
 			if (pPm->p_data == NULL)
 			{
 				free(pPm);
@@ -110,6 +139,24 @@ void DeletePixelmap32(Pixelmap32 **ppPm)
 	}
 }
 
+/*--------------------------------------------------------------------------------------------------------------------*/
+static int ReservePixelmap32(Pixelmap32 *pPm, uint32_t dx, uint32_t dy)
+{// grows p_data to hold dx x dy pixels and takes that shape; never shrinks
+    if (((uint64_t)pPm->dx * pPm->dy) < ((uint64_t)dx * dy))
+    {
+        size_t bytes;
+        if (!Pixelmap32Bytes(dx, dy, &bytes))
+            return 0;
+        BGRA32 *pData = realloc(pPm->p_data, bytes);
+        if (pData == NULL)
+            return 0;
+        pPm->p_data = pData;
+        pPm->dx = dx;
+        pPm->dy = dy;
+    }
+    return !0;
+}
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 static int Pixelmap32IsEmpty(Pixelmap32 *pPm)
 {
@@ -131,6 +178,72 @@ static BGRA32 *GetPixelPtr(Pixelmap32 *pPm, uint32_t x0, uint32_t y0)
 	return (pPm->p_data + x0 + (pPm->dx * y0));
 }
 
+/*--------------------------------------------------------------------------------------------------------------------*/
+static int BGRA32Equal(const BGRA32 *p0, const BGRA32 *p1)
+{// compiles to a single 32-bit compare
+	return (memcmp(p0, p1, sizeof(BGRA32)) == 0);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static ScaleSpan WholeSpan(ScaleSpan *pSpan, int32_t lSrcLen, int32_t lDstLen)
+{// pSpan, or the span of the two rectangles themselves
+    ScaleSpan span = {lSrcLen, lDstLen, 0, 0};
+    if (pSpan != NULL)
+        span = *pSpan;
+    return span;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void SpanSourceRange(ScaleSpan *pSpan, int bVertical, int32_t lDstCnt, int32_t *plSrc0, int32_t *plSrc1)
+{// source samples, from the start of the span, that a pass reads to write lDstCnt pixels at pSpan->lDstOff
+    int32_t lDst0 = pSpan->lDstOff;
+    int32_t lDst1 = pSpan->lDstOff + lDstCnt - 1;
+
+    if (pSpan->lDstLen > pSpan->lSrcLen)
+    {
+        uint32_t ulInc = (pSpan->lSrcLen - 1);
+        ulInc = ((ulInc * 4096) / (pSpan->lDstLen - 1));
+        if (bVertical)
+        {// ScaleUpY works from the bottom up, blending with the line above
+            *plSrc0 = pSpan->lSrcLen - 2 - (int32_t)(((uint64_t)(pSpan->lDstLen - 1 - lDst0) * ulInc) >> 12);
+            *plSrc1 = pSpan->lSrcLen - 1 - (int32_t)(((uint64_t)(pSpan->lDstLen - 1 - lDst1) * ulInc) >> 12);
+        }
+        else
+        {// ScaleUpX blends with the sample to the right
+            *plSrc0 = (int32_t)(((uint64_t)lDst0 * ulInc) >> 12);
+            *plSrc1 = (int32_t)(((uint64_t)lDst1 * ulInc) >> 12) + 1;
+        }
+    }
+    else
+    if (pSpan->lDstLen < pSpan->lSrcLen)
+    {
+        uint32_t ulInc = pSpan->lSrcLen;
+        ulInc = ((ulInc * (1 << DOWN_NBITS)) / pSpan->lDstLen);
+        *plSrc0 = (int32_t)(((uint64_t)lDst0 * ulInc) >> DOWN_NBITS);
+        *plSrc1 = (int32_t)((((uint64_t)(lDst1 + 1) * ulInc) - 1) >> DOWN_NBITS);
+    }
+    else
+    {
+        *plSrc0 = lDst0;
+        *plSrc1 = lDst1;
+    }
+
+    if (*plSrc0 < 0)
+        *plSrc0 = 0;
+    if (*plSrc1 > (pSpan->lSrcLen - 1))
+        *plSrc1 = (pSpan->lSrcLen - 1);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void AddStats(Pixelmap32Stats *pStats, uint64_t ulPixels, uint64_t ulUniform)
+{
+	if (pStats != NULL)
+	{
+		pStats->pixels += ulPixels;
+		pStats->uniform_pixels += ulUniform;
+	}
+}
+
 //-----------------------------------------------------------------------------
 static int ClipBlt
 (
@@ -261,7 +374,10 @@ static void ScaleUpX
     Pixelmap32 *pDstPm,
     Rectangle  *pDstRc,
     Pixelmap32 *pSrcPm,
-    Rectangle  *pSrcRc
+    Rectangle  *pSrcRc,
+    uint32_t    ulFlags,
+    Pixelmap32Stats *pStats,
+    ScaleSpan  *pSpan
 )
 // assumes:
 //  all arguments point to valid data
@@ -273,20 +389,24 @@ static void ScaleUpX
 //  only play DDA once, store Acc's in an array then rip
     int32_t lDstDx = RectangleDx(pDstRc);
     int32_t lDstDy = RectangleDy(pDstRc);
-    int32_t lSrcDx = RectangleDx(pSrcRc);
+    ScaleSpan span = WholeSpan(pSpan, RectangleDx(pSrcRc), lDstDx);
+
+    uint32_t ulInc = (span.lSrcLen - 1);
+    ulInc = ((ulInc * 4096) / (span.lDstLen - 1));
+    uint64_t ulPos = ((uint64_t)span.lDstOff * ulInc); // phase of the first pixel written
 
     BGRA32 *pDstLine = GetPixelPtr(pDstPm, pDstRc->x0, pDstRc->y0);
-    BGRA32 *pSrcLine = GetPixelPtr(pSrcPm, pSrcRc->x0, pSrcRc->y0);
+    BGRA32 *pSrcLine = GetPixelPtr(pSrcPm, pSrcRc->x0 + (int32_t)(ulPos >> 12) - span.lSrcOff, pSrcRc->y0);
 
-    uint32_t ulInc = (lSrcDx - 1);
-    ulInc = ((ulInc * 4096) / (lDstDx - 1));
+    int bUniform = ((ulFlags & PIXELMAP32_UNIFORM_RUNS) != 0);
+    uint64_t ulUniform = 0;
 
     int32_t lYCnt = lDstDy;
     while (lYCnt--)
     {
         BGRA32 *pDst = pDstLine;
         BGRA32 *pSrc = pSrcLine;
-        uint32_t ulAcc = 0;
+        uint32_t ulAcc = (uint32_t)(ulPos & 4095);
         int32_t lXCnt = lDstDx;
         while (lXCnt--)
         {
@@ -295,6 +415,12 @@ static void ScaleUpX
                 *pDst++ = *pSrc;
             }
             else
+            if (bUniform && BGRA32Equal(pSrc, (pSrc + 1)))
+            {// blending a pixel with itself gives the pixel back
+                *pDst++ = *pSrc;
+                ulUniform++;
+            }
+            else
             {
                 BGRA32 *pSrc1 = (pSrc + 1);
                 uint32_t ulAcn = (4096 - ulAcc);
@@ -315,6 +441,8 @@ static void ScaleUpX
         pDstLine += pDstPm->dx;
         pSrcLine += pSrcPm->dx;
     }
+
+    AddStats(pStats, ((uint64_t)lDstDx * lDstDy), ulUniform);
 }
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -323,20 +451,29 @@ static void ScaleUpY
     Pixelmap32 *pDstPm,
     Rectangle  *pDstRc,
     Pixelmap32 *pSrcPm,
-    Rectangle  *pSrcRc
+    Rectangle  *pSrcRc,
+    uint32_t    ulFlags,
+    Pixelmap32Stats *pStats,
+    ScaleSpan  *pSpan
 )
 {
     int32_t lDstDx = RectangleDx(pDstRc);
     int32_t lDstDy = RectangleDy(pDstRc);
-    int32_t lSrcDy = RectangleDy(pSrcRc);
+    ScaleSpan span = WholeSpan(pSpan, RectangleDy(pSrcRc), lDstDy);
+
+    uint32_t ulInc = (span.lSrcLen - 1);
+    ulInc = ((ulInc * 4096) / (span.lDstLen - 1));
+    // works from the bottom up: phase of the last line written, counted from the bottom of the span
+    uint64_t ulPos = ((uint64_t)(span.lDstLen - span.lDstOff - lDstDy) * ulInc);
 
     BGRA32 *pDstLine = GetPixelPtr(pDstPm, pDstRc->x0, pDstRc->y1);
-    BGRA32 *pSrcLine = GetPixelPtr(pSrcPm, pSrcRc->x0, pSrcRc->y1);
+    BGRA32 *pSrcLine = GetPixelPtr(pSrcPm, pSrcRc->x0,
+        pSrcRc->y0 + (span.lSrcLen - 1 - (int32_t)(ulPos >> 12)) - span.lSrcOff);
 
-    uint32_t ulInc = (lSrcDy - 1);
-    ulInc = ((ulInc * 4096) / (lDstDy - 1));
+    int bUniform = ((ulFlags & PIXELMAP32_UNIFORM_RUNS) != 0);
+    uint64_t ulUniform = 0;
 
-    uint32_t ulAcc = 0;
+    uint32_t ulAcc = (uint32_t)(ulPos & 4095);
     int32_t lYCnt = lDstDy;
     while (lYCnt--)
     {
@@ -355,6 +492,13 @@ static void ScaleUpY
         	int32_t lXCnt = lDstDx;
             while (lXCnt--)
             {
+                if (bUniform && BGRA32Equal(pSrc, pSrc1))
+                {
+                    *pDst++ = *pSrc++;
+                    pSrc1++;
+                    ulUniform++;
+                    continue;
+                }
                 pDst->b = (uint8_t)(((pSrc->b * ulAcn) + (pSrc1->b * ulAcc)) >> 12);
                 pDst->g = (uint8_t)(((pSrc->g * ulAcn) + (pSrc1->g * ulAcc)) >> 12);
                 pDst->r = (uint8_t)(((pSrc->r * ulAcn) + (pSrc1->r * ulAcc)) >> 12);
@@ -374,6 +518,8 @@ static void ScaleUpY
 
         pDstLine -= pDstPm->dx;
     }
+
+    AddStats(pStats, ((uint64_t)lDstDx * lDstDy), ulUniform);
 }
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -382,7 +528,10 @@ static void ScaleDownY
     Pixelmap32 *pDstPm,
     Rectangle  *pDstRc,
     Pixelmap32 *pSrcPm,
-    Rectangle  *pSrcRc
+    Rectangle  *pSrcRc,
+    uint32_t    ulFlags,
+    Pixelmap32Stats *pStats,
+    ScaleSpan  *pSpan
 )
 // assumes:
 //  all arguments point to valid data
@@ -393,14 +542,17 @@ static void ScaleDownY
     int32_t lDstDx = RectangleDx(pDstRc);
     int32_t lDstDy = RectangleDy(pDstRc);
     int32_t lSrcDy = RectangleDy(pSrcRc);
+    ScaleSpan span = WholeSpan(pSpan, lSrcDy, lDstDy);
 
-    BGRA32 *pDstLine = GetPixelPtr(pDstPm, pDstRc->x0, pDstRc->y0);
-    BGRA32 *pSrcLine = GetPixelPtr(pSrcPm, pSrcRc->x0, pSrcRc->y0);
-
-    uint32_t ulMax = lDstDy;
-    uint32_t ulInc = lSrcDy;
+    uint32_t ulMax = span.lDstLen;
+    uint32_t ulInc = span.lSrcLen;
     ulInc = ((ulInc * (1 << DOWN_NBITS)) / ulMax);
 	ulMax = 1 << DOWN_NBITS;
+    uint64_t ulPos = ((uint64_t)span.lDstOff * ulInc); // phase of the first pixel written
+    int32_t lSrcSkip = (int32_t)(ulPos >> DOWN_NBITS) - span.lSrcOff;
+
+    BGRA32 *pDstLine = GetPixelPtr(pDstPm, pDstRc->x0, pDstRc->y0);
+    BGRA32 *pSrcLine = GetPixelPtr(pSrcPm, pSrcRc->x0, pSrcRc->y0 + lSrcSkip);
 
     uint32_t ulB = 0;
     uint32_t ulG = 0;
@@ -415,15 +567,82 @@ static void ScaleDownY
     uint32_t ulAcn;
     int32_t lYCnt;
 
+    int bUniform = ((ulFlags & PIXELMAP32_UNIFORM_RUNS) != 0) && (ulInc <= (UINT32_MAX / 255)); // sums must not wrap
+    uint64_t ulUniform = 0;
+
+    // rows from pSrcLine; a column's rows are a whole line apart, so one past the end of a
+    // column is far past the end of p_data and is never formed as a pointer
+    int32_t lRow;    // row of pSrc
+    int32_t lRun;    // one past the run of identical samples containing pSrc
+    int32_t lSrcEnd = (lSrcDy - lSrcSkip); // one past the column
+
+    // Vertical runs are found line by line, not down each column: pbSame[(row * lPieces) + piece]
+    // says a RUN_COLUMNS wide piece of a source line equals the same piece of the line above.
+    // Equal pieces imply equal samples, so the shortcut stays exact; the column walk below then
+    // reads this table instead of striding through the source to find where a run ends.
+    int32_t lPieces = ((lDstDx + RUN_COLUMNS - 1) / RUN_COLUMNS);
+    uint8_t *pbSame = NULL;
+    if (bUniform)
+    {
+        pbSame = malloc((size_t)lSrcEnd * lPieces);
+        if (pbSame == NULL)
+            bUniform = 0; // just slower
+    }
+    if (bUniform)
+    {
+        int32_t lLine;
+        int32_t lPiece;
+        memset(pbSame, 0, lPieces);
+        for (lLine = 1; lLine < lSrcEnd; lLine++)
+        {
+            BGRA32 *pLine = pSrcLine + ((size_t)lLine * pSrcPm->dx);
+            for (lPiece = 0; lPiece < lPieces; lPiece++)
+            {
+                int32_t lX0 = (lPiece * RUN_COLUMNS);
+                int32_t lN = ((lDstDx - lX0) < RUN_COLUMNS) ? (lDstDx - lX0) : RUN_COLUMNS;
+                pbSame[((size_t)lLine * lPieces) + lPiece] =
+                    (memcmp(pLine + lX0, (pLine - pSrcPm->dx) + lX0, lN * sizeof(BGRA32)) == 0);
+            }
+        }
+    }
+    uint8_t *pbSameCol = pbSame; // piece of the current column in row 0
+
     int32_t lXCnt = lDstDx;
     while (lXCnt--)
     {
         pSrc = pSrcLine;
         pDst = pDstLine;
-        ulAcc = 0;
+        lRow = 0;
+        lRun = 0;
+        ulAcc = (uint32_t)(ulPos & (ulMax - 1));
         lYCnt = lDstDy;
         while (lYCnt--)
         {
+            if (bUniform)
+            {// if every sample under this pixel is the same colour the average is that colour
+                uint32_t ulNxt = ulAcc + ulInc;
+                int32_t lNxt = lRow + (int32_t)(ulNxt >> DOWN_NBITS);
+                ulNxt &= (ulMax - 1);
+
+                if (lRow >= lRun)
+                {
+                    lRun = lRow + 1;
+                    while (lRun < lSrcEnd && pbSameCol[(size_t)lRun * lPieces])
+                        lRun++;
+                }
+                if (((ulNxt != 0) ? (lNxt + 1) : lNxt) <= lRun)
+                {
+                    *pDst = *pSrc;
+                    pDst += pDstPm->dx;
+                    if (lNxt < lSrcEnd) // else the column is used up and pSrc is not read again
+                        pSrc += ((lNxt - lRow) * pSrcPm->dx);
+                    lRow = lNxt;
+                    ulAcc = ulNxt;
+                    ulUniform++;
+                    continue;
+                }
+                lRow = lNxt; // where the averaging below leaves pSrc
+            }
             if (ulAcc != 0)
             {
                 ulAcn = (ulMax - ulAcc);
@@ -469,7 +688,12 @@ static void ScaleDownY
         }
         pSrcLine++;
         pDstLine++;
+        if (((lDstDx - lXCnt) % RUN_COLUMNS) == 0)
+            pbSameCol++;
     }
+    free(pbSame);
+
+    AddStats(pStats, ((uint64_t)lDstDx * lDstDy), ulUniform);
 }
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -478,7 +702,10 @@ static void ScaleDownX
     Pixelmap32 *pDstPm,
     Rectangle  *pDstRc,
     Pixelmap32 *pSrcPm,
-    Rectangle  *pSrcRc
+    Rectangle  *pSrcRc,
+    uint32_t    ulFlags,
+    Pixelmap32Stats *pStats,
+    ScaleSpan  *pSpan
 )
 // assumes:
 //  all arguments point to valid data
@@ -489,20 +716,28 @@ static void ScaleDownX
     int32_t lDstDx = RectangleDx(pDstRc);
     int32_t lDstDy = RectangleDy(pDstRc);
     int32_t lSrcDx = RectangleDx(pSrcRc);
+    ScaleSpan span = WholeSpan(pSpan, lSrcDx, lDstDx);
 
-    BGRA32 *pDstLine = GetPixelPtr(pDstPm, pDstRc->x0, pDstRc->y0);
-    BGRA32 *pSrcLine = GetPixelPtr(pSrcPm, pSrcRc->x0, pSrcRc->y0);
-
-    uint32_t ulMax = lDstDx;
-    uint32_t ulInc = lSrcDx;
+    uint32_t ulMax = span.lDstLen;
+    uint32_t ulInc = span.lSrcLen;
     ulInc = ((ulInc * (1 << DOWN_NBITS)) / ulMax);
 	ulMax = 1 << DOWN_NBITS;
+    uint64_t ulPos = ((uint64_t)span.lDstOff * ulInc); // phase of the first pixel written
+    int32_t lSrcSkip = (int32_t)(ulPos >> DOWN_NBITS) - span.lSrcOff;
+
+    BGRA32 *pDstLine = GetPixelPtr(pDstPm, pDstRc->x0, pDstRc->y0);
+    BGRA32 *pSrcLine = GetPixelPtr(pSrcPm, pSrcRc->x0 + lSrcSkip, pSrcRc->y0);
+
+    int bUniform = ((ulFlags & PIXELMAP32_UNIFORM_RUNS) != 0) && (ulInc <= (UINT32_MAX / 255)); // sums must not wrap
+    uint64_t ulUniform = 0;
 
     int32_t lYCnt = lDstDy;
     while (lYCnt--)
     {
         BGRA32 *pDst = pDstLine;
         BGRA32 *pSrc = pSrcLine;
+        BGRA32 *pRun = pSrcLine;              // one past the run of identical samples containing pSrc
+        BGRA32 *pSrcEnd = pSrcLine + (lSrcDx - lSrcSkip); // one past the line
 
         uint32_t ulB = 0;
         uint32_t ulG = 0;
@@ -510,10 +745,31 @@ static void ScaleDownX
         uint32_t ulA = 0;
         uint32_t ulD = 0;
 
-        uint32_t ulAcc = 0;
+        uint32_t ulAcc = (uint32_t)(ulPos & (ulMax - 1));
         int32_t lXCnt = lDstDx;
         while (lXCnt--)
         {
+            if (bUniform)
+            {// if every sample under this pixel is the same colour the average is that colour
+                uint32_t ulNxt = ulAcc + ulInc;
+                BGRA32 *pNxt = pSrc + (ulNxt >> DOWN_NBITS);
+                ulNxt &= (ulMax - 1);
+
+                if (pSrc >= pRun)
+                {
+                    pRun = pSrc + 1;
+                    while (pRun < pSrcEnd && BGRA32Equal(pRun, pSrc))
+                        pRun++;
+                }
+                if (((ulNxt != 0) ? (pNxt + 1) : pNxt) <= pRun)
+                {
+                    *pDst++ = *pSrc;
+                    pSrc = pNxt;
+                    ulAcc = ulNxt;
+                    ulUniform++;
+                    continue;
+                }
+            }
             if (ulAcc != 0)
             {
                 uint32_t ulAcn = (ulMax - ulAcc);
@@ -559,6 +815,100 @@ static void ScaleDownX
         pDstLine += pDstPm->dx;
         pSrcLine += pSrcPm->dx;
     }
+
+    AddStats(pStats, ((uint64_t)lDstDx * lDstDy), ulUniform);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static int PreferYXOrder(int32_t lSrcDx, int32_t lSrcDy, int32_t lDstDx, int32_t lDstDy, uint32_t ulFlags)
+{
+    if (ulFlags & PIXELMAP32_ORDER_XY)
+        return 0;
+    if (ulFlags & PIXELMAP32_ORDER_YX)
+        return !0;
+
+    return Pixelmap32PreferYXOrder(lSrcDx, lSrcDy, lDstDx, lDstDy);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static int ScaleTwoPass
+(
+    Pixelmap32 *pDstPm,
+    Rectangle  *pDstRc,
+    Pixelmap32 *pSrcPm,
+    Rectangle  *pSrcRc,
+    ScaleSpan  *pSpanX,
+    ScaleSpan  *pSpanY,
+    ScalePass   pfnX,
+    ScalePass   pfnY,
+    uint32_t    ulFlags,
+    Pixelmap32Stats *pStats,
+    Pixelmap32 *pScratchPm
+)
+// pDstRc is the part of the span written (all of it when the spans are NULL), pSrcRc the whole source
+{
+    ScaleSpan spanX = WholeSpan(pSpanX, RectangleDx(pSrcRc), RectangleDx(pDstRc));
+    ScaleSpan spanY = WholeSpan(pSpanY, RectangleDy(pSrcRc), RectangleDy(pDstRc));
+    int bYX = PreferYXOrder(spanX.lSrcLen, spanY.lSrcLen, spanX.lDstLen, spanY.lDstLen, ulFlags);
+
+    // only the source samples under pDstRc are scaled, the intermediate holds just those
+    Rectangle rcSrc = *pSrcRc;
+    int32_t lSrc0;
+    int32_t lSrc1;
+
+    SpanSourceRange(&spanX, 0, RectangleDx(pDstRc), &lSrc0, &lSrc1);
+    rcSrc.x0 = pSrcRc->x0 + lSrc0;
+    rcSrc.x1 = pSrcRc->x0 + lSrc1;
+    spanX.lSrcOff = lSrc0;
+
+    SpanSourceRange(&spanY, !0, RectangleDy(pDstRc), &lSrc0, &lSrc1);
+    rcSrc.y0 = pSrcRc->y0 + lSrc0;
+    rcSrc.y1 = pSrcRc->y0 + lSrc1;
+    spanY.lSrcOff = lSrc0;
+
+    Rectangle rcTmp = {0, 0, 0, 0};
+    Pixelmap32 pmTmp;
+    Pixelmap32 *pTmpPm;
+    RectangleSetDx(&rcTmp, RectangleDx(bYX ? &rcSrc : pDstRc));
+    RectangleSetDy(&rcTmp, RectangleDy(bYX ? pDstRc : &rcSrc));
+
+    if (pScratchPm != NULL)
+    {// borrow the caller's block, viewed at the size of this intermediate
+        if (!ReservePixelmap32(pScratchPm, RectangleDx(&rcTmp), RectangleDy(&rcTmp)))
+            return 0; // false
+        pmTmp.dx = RectangleDx(&rcTmp);
+        pmTmp.dy = RectangleDy(&rcTmp);
+        pmTmp.p_data = pScratchPm->p_data;
+        pTmpPm = &pmTmp;
+    }
+    else
+    {
+        pTmpPm = NewPixelmap32(RectangleDx(&rcTmp), RectangleDy(&rcTmp));
+        if (pTmpPm == NULL)
+            return 0; // false
+    }
+
+    if (bYX)
+    {
+        pfnY(pTmpPm, &rcTmp, pSrcPm, &rcSrc, ulFlags, pStats, &spanY);
+        pfnX(pDstPm, pDstRc, pTmpPm, &rcTmp, ulFlags, pStats, &spanX);
+    }
+    else
+    {
+        pfnX(pTmpPm, &rcTmp, pSrcPm, &rcSrc, ulFlags, pStats, &spanX);
+        pfnY(pDstPm, pDstRc, pTmpPm, &rcTmp, ulFlags, pStats, &spanY);
+    }
+    if (pTmpPm != &pmTmp)
+        DeletePixelmap32(&pTmpPm);
+
+    if (pStats != NULL)
+    {
+        if (bYX)
+            pStats->yx_scales++;
+        else
+            pStats->xy_scales++;
+    }
+    return !0; // true
 }
 
 //-----------------------------------------------------------------------------
@@ -569,6 +919,21 @@ int ScalePixelmap32
     Pixelmap32 *pSrcPm,
     Rectangle  *pSrcRc
 )
+{
+    return ScalePixelmap32Ex(pDstPm, pDstRc, pSrcPm, pSrcRc, 0, NULL, NULL);
+}
+
+//-----------------------------------------------------------------------------
+int ScalePixelmap32Ex
+(
+    Pixelmap32 *pDstPm,
+    Rectangle  *pDstRc,
+    Pixelmap32 *pSrcPm,
+    Rectangle  *pSrcRc,
+    uint32_t    ulFlags,
+    Pixelmap32Stats *pStats,
+    Pixelmap32 *pTmpPm
+)
 {
     if (Pixelmap32IsEmpty(pDstPm) || Pixelmap32IsEmpty(pSrcPm) ||
         RectangleIsNull(pDstRc) || RectangleIsNull(pSrcRc))
@@ -612,91 +977,52 @@ int ScalePixelmap32
             if ((RectangleDx(&rcDstC) > RectangleDx(&rcSrcC)) &&
                 (RectangleDy(&rcDstC) > RectangleDy(&rcSrcC)))
             {
-                Rectangle rcTmp = rcDstC;
-                Pixelmap32 *pTmpPm;
-                RectangleSetDy(&rcTmp, RectangleDy(&rcSrcC));
-
-                pTmpPm = NewPixelmap32(RectangleDx(&rcTmp), RectangleDy(&rcTmp));
-
-                ScaleUpX(pTmpPm, &rcTmp, pSrcPm, &rcSrcC);
-                ScaleUpY(pDstPm, &rcDstC, pTmpPm, &rcTmp);
-                DeletePixelmap32(&pTmpPm);
-                return !0; // true
+                return ScaleTwoPass(pDstPm, &rcDstC, pSrcPm, &rcSrcC, NULL, NULL, ScaleUpX, ScaleUpY, ulFlags, pStats, pTmpPm);
             }
             else
             if ((RectangleDx(&rcDstC) < RectangleDx(&rcSrcC)) &&
                 (RectangleDy(&rcDstC) < RectangleDy(&rcSrcC)))
             {
-                Rectangle rcTmp = {0, 0, 0, 0};
-                Pixelmap32 *pTmpPm;
-				RectangleSetDx(&rcTmp, RectangleDx(&rcDstC));
-				RectangleSetDy(&rcTmp, RectangleDy(&rcSrcC));
-
-                pTmpPm = NewPixelmap32(RectangleDx(&rcTmp), RectangleDy(&rcTmp));
-
-                ScaleDownX(pTmpPm, &rcTmp, pSrcPm, &rcSrcC);
-                ScaleDownY(pDstPm, &rcDstC, pTmpPm, &rcTmp);
-                DeletePixelmap32(&pTmpPm);
-                return !0; // true
+                return ScaleTwoPass(pDstPm, &rcDstC, pSrcPm, &rcSrcC, NULL, NULL, ScaleDownX, ScaleDownY, ulFlags, pStats, pTmpPm);
             }
             else
             if ((RectangleDx(&rcDstC) < RectangleDx(&rcSrcC)) &&
                 (RectangleDy(&rcDstC) > RectangleDy(&rcSrcC)))
             {
-                Rectangle rcTmp = {0, 0, 0, 0};
-                Pixelmap32 *pTmpPm;
-                RectangleSetDx(&rcTmp, RectangleDx(&rcDstC));
-				RectangleSetDy(&rcTmp, RectangleDy(&rcSrcC));
-
-                pTmpPm = NewPixelmap32(RectangleDx(&rcTmp), RectangleDy(&rcTmp));
-
-                ScaleDownX(pTmpPm, &rcTmp, pSrcPm, &rcSrcC);
-				ScaleUpY(pDstPm, &rcDstC, pTmpPm, &rcTmp);
-                DeletePixelmap32(&pTmpPm);
-                return !0; // true
+                return ScaleTwoPass(pDstPm, &rcDstC, pSrcPm, &rcSrcC, NULL, NULL, ScaleDownX, ScaleUpY, ulFlags, pStats, pTmpPm);
             }
             else
             if ((RectangleDx(&rcDstC) > RectangleDx(&rcSrcC)) &&
                 (RectangleDy(&rcDstC) < RectangleDy(&rcSrcC)))
             {
-                Rectangle rcTmp = {0, 0, 0, 0};
-                Pixelmap32 *pTmpPm;
-				RectangleSetDx(&rcTmp, RectangleDx(&rcSrcC));
-				RectangleSetDy(&rcTmp, RectangleDy(&rcDstC));
-
-                pTmpPm = NewPixelmap32(RectangleDx(&rcTmp), RectangleDy(&rcTmp));
-
-				ScaleDownY(pTmpPm, &rcTmp, pSrcPm, &rcSrcC);
-                ScaleUpX(pDstPm, &rcDstC, pTmpPm, &rcTmp);
-                DeletePixelmap32(&pTmpPm);
-                return !0; // true
+                return ScaleTwoPass(pDstPm, &rcDstC, pSrcPm, &rcSrcC, NULL, NULL, ScaleUpX, ScaleDownY, ulFlags, pStats, pTmpPm);
             }
             else
             if ((RectangleDx(&rcDstC) >  RectangleDx(&rcSrcC)) &&
                 (RectangleDy(&rcDstC) == RectangleDy(&rcSrcC)))
             {
-                ScaleUpX(pDstPm, &rcDstC, pSrcPm, &rcSrcC);
+                ScaleUpX(pDstPm, &rcDstC, pSrcPm, &rcSrcC, ulFlags, pStats, NULL);
                 return !0; // true
             }
             else
             if ((RectangleDx(&rcDstC) <  RectangleDx(&rcSrcC)) &&
                 (RectangleDy(&rcDstC) == RectangleDy(&rcSrcC)))
             {
-				ScaleDownX(pDstPm, &rcDstC, pSrcPm, &rcSrcC);
+				ScaleDownX(pDstPm, &rcDstC, pSrcPm, &rcSrcC, ulFlags, pStats, NULL);
                 return !0; // true
             }
             else
             if ((RectangleDx(&rcDstC) == RectangleDx(&rcSrcC)) &&
                 (RectangleDy(&rcDstC) >  RectangleDy(&rcSrcC)))
             {
-                ScaleUpY(pDstPm, &rcDstC, pSrcPm, &rcSrcC);
+                ScaleUpY(pDstPm, &rcDstC, pSrcPm, &rcSrcC, ulFlags, pStats, NULL);
                 return !0; // true
             }
             else
             if ((RectangleDx(&rcDstC) == RectangleDx(&rcSrcC)) &&
                 (RectangleDy(&rcDstC) <  RectangleDy(&rcSrcC)))
             {
-				ScaleDownY(pDstPm, &rcDstC, pSrcPm, &rcSrcC);
+				ScaleDownY(pDstPm, &rcDstC, pSrcPm, &rcSrcC, ulFlags, pStats, NULL);
                 return !0; // true
             }
             else
@@ -710,4 +1036,139 @@ int ScalePixelmap32
 	return 0; // false
 }
 
+//-----------------------------------------------------------------------------
+int ScalePixelmap32Viewport
+(
+    Pixelmap32 *pDstPm,
+    Rectangle  *pDstRc,
+    Pixelmap32 *pSrcPm,
+    Rectangle  *pSrcRc,
+    uint32_t    ulFlags,
+    Pixelmap32Stats *pStats,
+    Pixelmap32 *pTmpPm
+)
+{// pDstRc places the whole virtual image; only the part inside pDstPm is scaled
+    if (Pixelmap32IsEmpty(pDstPm) || Pixelmap32IsEmpty(pSrcPm) ||
+        RectangleIsNull(pDstRc) || RectangleIsNull(pSrcRc))
+        return !0; // true
+
+    if (pSrcRc->x0 < 0 || pSrcRc->y0 < 0 ||
+        pSrcRc->x1 >= (int32_t)pSrcPm->dx || pSrcRc->y1 >= (int32_t)pSrcPm->dy)
+        return 0; // false, the source must be whole for the phases to line up
+
+    Rectangle rcVis = *pDstRc; // visible part, in pDstPm
+    if (rcVis.x0 < 0)
+        rcVis.x0 = 0;
+    if (rcVis.y0 < 0)
+        rcVis.y0 = 0;
+    if (rcVis.x1 >= (int32_t)pDstPm->dx)
+        rcVis.x1 = pDstPm->dx - 1;
+    if (rcVis.y1 >= (int32_t)pDstPm->dy)
+        rcVis.y1 = pDstPm->dy - 1;
+    if (RectangleIsNull(&rcVis))
+        return !0; // true, nothing visible
+
+    ScaleSpan spanX = {RectangleDx(pSrcRc), RectangleDx(pDstRc), (rcVis.x0 - pDstRc->x0), 0};
+    ScaleSpan spanY = {RectangleDy(pSrcRc), RectangleDy(pDstRc), (rcVis.y0 - pDstRc->y0), 0};
+    ScalePass pfnX = (spanX.lDstLen > spanX.lSrcLen) ? ScaleUpX : ScaleDownX;
+    ScalePass pfnY = (spanY.lDstLen > spanY.lSrcLen) ? ScaleUpY : ScaleDownY;
+
+    if (spanX.lDstLen != spanX.lSrcLen && spanY.lDstLen != spanY.lSrcLen)
+    {
+        return ScaleTwoPass(pDstPm, &rcVis, pSrcPm, pSrcRc, &spanX, &spanY, pfnX, pfnY, ulFlags, pStats, pTmpPm);
+    }
+
+    // one axis or neither is scaled; the other maps 1:1 onto the source
+    Rectangle rcSrc = *pSrcRc;
+    int32_t lSrc0;
+    int32_t lSrc1;
+
+    SpanSourceRange(&spanX, 0, RectangleDx(&rcVis), &lSrc0, &lSrc1);
+    rcSrc.x0 = pSrcRc->x0 + lSrc0;
+    rcSrc.x1 = pSrcRc->x0 + lSrc1;
+    spanX.lSrcOff = lSrc0;
+
+    SpanSourceRange(&spanY, !0, RectangleDy(&rcVis), &lSrc0, &lSrc1);
+    rcSrc.y0 = pSrcRc->y0 + lSrc0;
+    rcSrc.y1 = pSrcRc->y0 + lSrc1;
+    spanY.lSrcOff = lSrc0;
+
+    if (spanX.lDstLen != spanX.lSrcLen)
+        pfnX(pDstPm, &rcVis, pSrcPm, &rcSrc, ulFlags, pStats, &spanX);
+    else
+    if (spanY.lDstLen != spanY.lSrcLen)
+        pfnY(pDstPm, &rcVis, pSrcPm, &rcSrc, ulFlags, pStats, &spanY);
+    else
+        return ScalePixelmap32Ex(pDstPm, &rcVis, pSrcPm, &rcSrc, ulFlags, pStats, pTmpPm);
+
+    return !0; // true
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void ShrinkInPlaceX(Pixelmap32 *pPm, Rectangle *pRc, uint32_t newDx)
+{
+    if (newDx < pPm->dx)
+    {
+        Pixelmap32 pmDst = *pPm;
+        Rectangle rcDst = *pRc;
+        pmDst.dx = newDx;
+        RectangleSetDx(&rcDst, newDx);
+
+        ScaleDownX(&pmDst, &rcDst, pPm, pRc, 0, NULL, NULL);
+        *pPm = pmDst;
+        *pRc = rcDst;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void ShrinkInPlaceY(Pixelmap32 *pPm, Rectangle *pRc, uint32_t newDy)
+{
+    if (newDy < pPm->dy)
+    {
+        Pixelmap32 pmDst = *pPm;
+        Rectangle rcDst = *pRc;
+        pmDst.dy = newDy;
+        RectangleSetDy(&rcDst, newDy);
+
+        ScaleDownY(&pmDst, &rcDst, pPm, pRc, 0, NULL, NULL);
+        *pPm = pmDst;
+        *pRc = rcDst;
+    }
+}
+
+//-----------------------------------------------------------------------------
+int ShrinkPixelmap32InPlace
+(
+    Pixelmap32 *pPm,
+    uint32_t    newDx,
+    uint32_t    newDy
+)
+{// Each reduced line is written no further along the buffer than the first
+ // source sample it still needs, so both passes can run over p_data in place.
+    if (Pixelmap32IsEmpty(pPm) || newDx == 0 || newDy == 0 ||
+        newDx > pPm->dx || newDy > pPm->dy)
+        return 0; // false
+
+    Pixelmap32 pmSrc = *pPm;
+    Rectangle rcSrc = {0, 0, 0, 0};
+    RectangleSetDx(&rcSrc, pPm->dx);
+    RectangleSetDy(&rcSrc, pPm->dy);
+
+    // same pass order as ScalePixelmap32; a pass is skipped once its axis is at size
+    if (PreferYXOrder(pPm->dx, pPm->dy, newDx, newDy, 0))
+        ShrinkInPlaceY(&pmSrc, &rcSrc, newDy);
+    ShrinkInPlaceX(&pmSrc, &rcSrc, newDx);
+    ShrinkInPlaceY(&pmSrc, &rcSrc, newDy);
+
+    if (newDx != pPm->dx || newDy != pPm->dy)
+    {
+        BGRA32 *pData = realloc(pPm->p_data, (size_t)newDx * newDy * sizeof(BGRA32));
+        if (pData != NULL) // else keep the larger block
+            pPm->p_data = pData;
+        pPm->dx = newDx;
+        pPm->dy = newDy;
+    }
+    return !0; // true
+}
+
 // EOF
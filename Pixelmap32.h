@@ -51,6 +51,18 @@ typedef struct {
 
 #pragma pack(pop)
 
+// ScalePixelmap32Ex flags
+#define PIXELMAP32_UNIFORM_RUNS 0x0001 // fill runs of identical pixels directly (output is unchanged)
+#define PIXELMAP32_ORDER_XY     0x0002 // force the horizontal pass first (default: cheaper order by cost estimate)
+#define PIXELMAP32_ORDER_YX     0x0004 // force the vertical pass first
+
+typedef struct {
+	uint64_t pixels;         // pixels written by the scaling passes
+	uint64_t uniform_pixels; // of those, filled directly from a uniform run
+	uint64_t xy_scales;      // two-pass scales run horizontal pass first
+	uint64_t yx_scales;      // two-pass scales run vertical pass first
+} Pixelmap32Stats;
+
 Pixelmap32 *NewPixelmap32(uint32_t dx, uint32_t dy);
 
 void DeletePixelmap32(Pixelmap32 **ppPm);
@@ -58,6 +70,24 @@ void DeletePixelmap32(Pixelmap32 **ppPm);
 int ScalePixelmap32(Pixelmap32 *pDstPm, Rectangle  *pDstRc,
 	Pixelmap32 *pSrcPm, Rectangle  *pSrcRc);
 
+// pStats may be NULL; when given, counts are added to its current values.
+// pTmpPm may be NULL; when given, it holds the intermediate and is grown as needed,
+// so a caller can keep one per thread (start with NewPixelmap32(0, 0)).
+int ScalePixelmap32Ex(Pixelmap32 *pDstPm, Rectangle  *pDstRc,
+	Pixelmap32 *pSrcPm, Rectangle  *pSrcRc, uint32_t ulFlags, Pixelmap32Stats *pStats,
+	Pixelmap32 *pTmpPm);
+
+// Renders part of a virtual image: pSrcRc scaled to the size of pDstRc, placed at pDstRc
+// (which may run off pDstPm on any side). Only the part inside pDstPm is computed, and
+// every pixel equals the one a full ScalePixelmap32Ex would give, so adjacent tiles meet
+// without seams. pSrcRc must lie within pSrcPm.
+int ScalePixelmap32Viewport(Pixelmap32 *pDstPm, Rectangle  *pDstRc,
+	Pixelmap32 *pSrcPm, Rectangle  *pSrcRc, uint32_t ulFlags, Pixelmap32Stats *pStats,
+	Pixelmap32 *pTmpPm);
+
+// area-average reduction to newDx x newDy within pPm->p_data; same result as ScalePixelmap32
+int ShrinkPixelmap32InPlace(Pixelmap32 *pPm, uint32_t newDx, uint32_t newDy);
+
 #ifdef __cplusplus
 }
 #endif
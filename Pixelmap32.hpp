@@ -0,0 +1,476 @@
+/*
+  Pixelmap32.hpp
+
+  Header-only C++ versions of the Pixelmap32 scaling passes, templated on the
+  pixel format (channel type, channel count, channel order), for pixmaps that
+  are not 8-bit BGRA: gray, gray + alpha, 16-bit and float channels. Channel
+  count and type are compile-time constants, so the per-channel loops unroll
+  and a gray pixmap moves a quarter of the bytes of its BGRA32 equivalent.
+
+  Pixmap<BGRA8> scales to exactly the same pixels as ScalePixelmap32.
+
+  Copyright (C) 2004-2013 by Gary Frattarola. All rights reserved.
+
+  This code is distributed under the terms of the zlib license:
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Gary Frattarola
+  gary.frattarola@gmail.com
+*/
+
+#ifndef _Pixelmap32_hpp_
+#define _Pixelmap32_hpp_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "Pixelmap32.h"
+#include "Pixelmap32Tuning.h"
+
+namespace pixelmap {
+
+// Channel order only names the channels; every pass treats them alike.
+enum ChannelOrder { CHANNELS_GRAY, CHANNELS_GRAY_ALPHA, CHANNELS_BGRA, CHANNELS_RGBA };
+
+template <typename T, int N, ChannelOrder O>
+struct PixelFormat
+{
+    typedef T Channel;
+    enum { channels = N };
+    static const ChannelOrder order = O;
+};
+
+typedef PixelFormat<uint8_t,  4, CHANNELS_BGRA>       BGRA8; // same layout as BGRA32
+typedef PixelFormat<uint16_t, 4, CHANNELS_BGRA>       BGRA16;
+typedef PixelFormat<float,    4, CHANNELS_BGRA>       BGRAF;
+typedef PixelFormat<uint8_t,  2, CHANNELS_GRAY_ALPHA> GrayAlpha8;
+typedef PixelFormat<uint16_t, 2, CHANNELS_GRAY_ALPHA> GrayAlpha16;
+typedef PixelFormat<uint8_t,  1, CHANNELS_GRAY>       Gray8;
+typedef PixelFormat<uint16_t, 1, CHANNELS_GRAY>       Gray16;
+typedef PixelFormat<float,    1, CHANNELS_GRAY>       GrayF;
+
+// A view of caller-owned pixels: dy rows of dx pixels, packed, channels interleaved.
+template <typename F>
+struct Pixmap
+{
+    uint32_t dx, dy;
+    typename F::Channel *p_data;
+};
+
+enum PassOrder { PASS_AUTO, PASS_XY, PASS_YX }; // PASS_AUTO: cheaper order by cost estimate
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+inline Pixmap<BGRA8> Wrap(Pixelmap32 *pPm)
+{
+    Pixmap<BGRA8> pm = {pPm->dx, pPm->dy, reinterpret_cast<uint8_t *>(pPm->p_data)};
+    return pm;
+}
+
+namespace detail {
+
+// Per-channel arithmetic. Integer channels use the fixed-point weights of Pixelmap32.c
+// as they are; Sum must hold a channel times the whole weight of one destination pixel.
+template <typename T, typename S>
+struct IntegerChannelMath
+{
+    typedef S Sum;
+
+    static T Blend(T c0, T c1, uint32_t ulAcn, uint32_t ulAcc)
+    {
+        return (T)((((uint32_t)c0 * ulAcn) + ((uint32_t)c1 * ulAcc)) >> 12);
+    }
+    static Sum Weigh(T c, uint32_t ulWeight)
+    {
+        return ((Sum)c * ulWeight);
+    }
+    static T Average(Sum sum, uint32_t ulD)
+    {
+        return (T)((sum + (1 << (PIXELMAP32_DOWN_NBITS - 1))) / ulD);
+    }
+};
+
+template <typename T> struct ChannelMath;
+
+template <> struct ChannelMath<uint8_t>  : IntegerChannelMath<uint8_t, uint32_t> {};
+template <> struct ChannelMath<uint16_t> : IntegerChannelMath<uint16_t, uint64_t> {};
+
+template <> struct ChannelMath<float>
+{
+    typedef float Sum;
+
+    static float Blend(float c0, float c1, uint32_t ulAcn, uint32_t ulAcc)
+    {
+        return (((c0 * ulAcn) + (c1 * ulAcc)) * (1.0f / 4096));
+    }
+    static Sum Weigh(float c, uint32_t ulWeight)
+    {
+        return (c * ulWeight);
+    }
+    static float Average(Sum sum, uint32_t ulD)
+    {
+        return (sum / ulD);
+    }
+};
+
+// Calls op(c) for each channel c, unrolled at compile time so per-channel sums stay in registers.
+template <int N>
+struct EachChannel
+{
+    template <typename Op> static void Do(const Op &op)
+    {
+        EachChannel<N - 1>::Do(op);
+        op(N - 1);
+    }
+};
+
+template <>
+struct EachChannel<0>
+{
+    template <typename Op> static void Do(const Op &) {}
+};
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+inline int32_t RectangleDx(const Rectangle &rc)
+{
+    return (rc.x1 - rc.x0 + 1);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+inline int32_t RectangleDy(const Rectangle &rc)
+{
+    return (rc.y1 - rc.y0 + 1);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+template <typename F>
+inline typename F::Channel *PixelPtr(const Pixmap<F> &pm, int32_t x0, int32_t y0)
+{
+    return (pm.p_data + (((size_t)pm.dx * y0) + x0) * F::channels);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+template <typename F>
+void ScaleUpX(Pixmap<F> &dst, const Rectangle &dstRc, const Pixmap<F> &src, const Rectangle &srcRc)
+{
+    typedef typename F::Channel T;
+    typedef ChannelMath<T> M;
+    const int N = F::channels;
+
+    int32_t lDstDx = RectangleDx(dstRc);
+    int32_t lDstDy = RectangleDy(dstRc);
+    int32_t lSrcDx = RectangleDx(srcRc);
+
+    T *pDstLine = PixelPtr(dst, dstRc.x0, dstRc.y0);
+    const T *pSrcLine = PixelPtr(src, srcRc.x0, srcRc.y0);
+
+    uint32_t ulInc = (lSrcDx - 1);
+    ulInc = ((ulInc * 4096) / (lDstDx - 1));
+
+    int32_t lYCnt = lDstDy;
+    while (lYCnt--)
+    {
+        T *pDst = pDstLine;
+        const T *pSrc = pSrcLine;
+        uint32_t ulAcc = 0;
+        int32_t lXCnt = lDstDx;
+        while (lXCnt--)
+        {
+            if (ulAcc == 0)
+            {
+                EachChannel<N>::Do([&](int c) { pDst[c] = pSrc[c]; });
+            }
+            else
+            {
+                uint32_t ulAcn = (4096 - ulAcc);
+                EachChannel<N>::Do([&](int c) { pDst[c] = M::Blend(pSrc[c], pSrc[N + c], ulAcn, ulAcc); });
+            }
+            pDst += N;
+
+            ulAcc += ulInc;
+            if (ulAcc & 4096)
+            {
+                ulAcc &= 4095;
+                pSrc += N;
+            }
+        }
+        pDstLine += (size_t)dst.dx * N;
+        pSrcLine += (size_t)src.dx * N;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+template <typename F>
+void ScaleUpY(Pixmap<F> &dst, const Rectangle &dstRc, const Pixmap<F> &src, const Rectangle &srcRc)
+{// bottom up, as in Pixelmap32.c
+    typedef typename F::Channel T;
+    typedef ChannelMath<T> M;
+    const int N = F::channels;
+
+    int32_t lDstDx = RectangleDx(dstRc);
+    int32_t lDstDy = RectangleDy(dstRc);
+    int32_t lSrcDy = RectangleDy(srcRc);
+
+    T *pDstLine = PixelPtr(dst, dstRc.x0, dstRc.y1);
+    const T *pSrcLine = PixelPtr(src, srcRc.x0, srcRc.y1);
+
+    uint32_t ulInc = (lSrcDy - 1);
+    ulInc = ((ulInc * 4096) / (lDstDy - 1));
+
+    uint32_t ulAcc = 0;
+    int32_t lYCnt = lDstDy;
+    while (lYCnt--)
+    {
+        if (ulAcc == 0)
+        {
+            memcpy(pDstLine, pSrcLine, (size_t)lDstDx * N * sizeof(T));
+        }
+        else
+        {
+            T *pDst = pDstLine;
+            const T *pSrc = pSrcLine;
+            const T *pSrc1 = pSrcLine - ((size_t)src.dx * N);
+            uint32_t ulAcn = (4096 - ulAcc);
+
+            int32_t lCnt = lDstDx * N;
+            while (lCnt--)
+                *pDst++ = M::Blend(*pSrc++, *pSrc1++, ulAcn, ulAcc);
+        }
+
+        ulAcc += ulInc;
+        if (ulAcc & 4096)
+        {
+            ulAcc &= 4095;
+            pSrcLine -= (size_t)src.dx * N;
+        }
+        pDstLine -= (size_t)dst.dx * N;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+template <typename F>
+void ScaleDownX(Pixmap<F> &dst, const Rectangle &dstRc, const Pixmap<F> &src, const Rectangle &srcRc)
+{
+    typedef typename F::Channel T;
+    typedef ChannelMath<T> M;
+    typedef typename M::Sum S;
+    const int N = F::channels;
+
+    int32_t lDstDx = RectangleDx(dstRc);
+    int32_t lDstDy = RectangleDy(dstRc);
+    int32_t lSrcDx = RectangleDx(srcRc);
+
+    T *pDstLine = PixelPtr(dst, dstRc.x0, dstRc.y0);
+    const T *pSrcLine = PixelPtr(src, srcRc.x0, srcRc.y0);
+
+    uint32_t ulMax = lDstDx;
+    uint32_t ulInc = lSrcDx;
+    ulInc = ((ulInc * (1 << PIXELMAP32_DOWN_NBITS)) / ulMax);
+    ulMax = 1 << PIXELMAP32_DOWN_NBITS;
+
+    int32_t lYCnt = lDstDy;
+    while (lYCnt--)
+    {
+        T *pDst = pDstLine;
+        const T *pSrc = pSrcLine;
+        uint32_t ulAcc = 0;
+        int32_t lXCnt = lDstDx;
+        while (lXCnt--)
+        {
+            S sum[N] = {};
+            uint32_t ulD = 0;
+
+            if (ulAcc != 0)
+            {
+                uint32_t ulAcn = (ulMax - ulAcc);
+                EachChannel<N>::Do([&](int c) { sum[c] += M::Weigh(pSrc[c], ulAcn); });
+                ulD += ulAcn;
+                ulAcc -= ulMax;
+                pSrc += N;
+            }
+            ulAcc += ulInc;
+            while (ulAcc >= ulMax)
+            {
+                EachChannel<N>::Do([&](int c) { sum[c] += M::Weigh(pSrc[c], ulMax); });
+                ulD += ulMax;
+                ulAcc -= ulMax;
+                pSrc += N;
+            }
+            if (ulAcc != 0)
+            {
+                EachChannel<N>::Do([&](int c) { sum[c] += M::Weigh(pSrc[c], ulAcc); });
+                ulD += ulAcc;
+            }
+            EachChannel<N>::Do([&](int c) { pDst[c] = M::Average(sum[c], ulD); });
+            pDst += N;
+        }
+        pDstLine += (size_t)dst.dx * N;
+        pSrcLine += (size_t)src.dx * N;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+template <typename F>
+void ScaleDownY(Pixmap<F> &dst, const Rectangle &dstRc, const Pixmap<F> &src, const Rectangle &srcRc)
+{
+    typedef typename F::Channel T;
+    typedef ChannelMath<T> M;
+    typedef typename M::Sum S;
+    const int N = F::channels;
+
+    int32_t lDstDx = RectangleDx(dstRc);
+    int32_t lDstDy = RectangleDy(dstRc);
+    int32_t lSrcDy = RectangleDy(srcRc);
+
+    T *pDstLine = PixelPtr(dst, dstRc.x0, dstRc.y0);
+    const T *pSrcLine = PixelPtr(src, srcRc.x0, srcRc.y0);
+    size_t dstStride = (size_t)dst.dx * N;
+    size_t srcStride = (size_t)src.dx * N;
+
+    uint32_t ulMax = lDstDy;
+    uint32_t ulInc = lSrcDy;
+    ulInc = ((ulInc * (1 << PIXELMAP32_DOWN_NBITS)) / ulMax);
+    ulMax = 1 << PIXELMAP32_DOWN_NBITS;
+
+    int32_t lXCnt = lDstDx;
+    while (lXCnt--)
+    {
+        T *pDst = pDstLine;
+        const T *pSrc = pSrcLine;
+        uint32_t ulAcc = 0;
+        int32_t lYCnt = lDstDy;
+        while (lYCnt--)
+        {
+            S sum[N] = {};
+            uint32_t ulD = 0;
+
+            if (ulAcc != 0)
+            {
+                uint32_t ulAcn = (ulMax - ulAcc);
+                EachChannel<N>::Do([&](int c) { sum[c] += M::Weigh(pSrc[c], ulAcn); });
+                ulD += ulAcn;
+                ulAcc -= ulMax;
+                pSrc += srcStride;
+            }
+            ulAcc += ulInc;
+            while (ulAcc >= ulMax)
+            {
+                EachChannel<N>::Do([&](int c) { sum[c] += M::Weigh(pSrc[c], ulMax); });
+                ulD += ulMax;
+                ulAcc -= ulMax;
+                pSrc += srcStride;
+            }
+            if (ulAcc != 0)
+            {
+                EachChannel<N>::Do([&](int c) { sum[c] += M::Weigh(pSrc[c], ulAcc); });
+                ulD += ulAcc;
+            }
+            EachChannel<N>::Do([&](int c) { pDst[c] = M::Average(sum[c], ulD); });
+            pDst += dstStride;
+        }
+        pSrcLine += N;
+        pDstLine += N;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+inline bool PreferYXOrder(int32_t lSrcDx, int32_t lSrcDy, int32_t lDstDx, int32_t lDstDy, PassOrder order)
+{// the same choice as ScalePixelmap32, so BGRA8 scales to the same pixels
+    if (order != PASS_AUTO)
+        return (order == PASS_YX);
+
+    return (Pixelmap32PreferYXOrder(lSrcDx, lSrcDy, lDstDx, lDstDy) != 0);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+template <typename F>
+bool RectangleInside(const Rectangle &rc, const Pixmap<F> &pm)
+{
+    return (rc.x0 >= 0 && rc.y0 >= 0 && rc.x1 < (int32_t)pm.dx && rc.y1 < (int32_t)pm.dy);
+}
+
+} // namespace detail
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+// Scales srcRc of src into dstRc of dst. Unlike ScalePixelmap32 there is no clipping:
+// both rectangles must lie inside their pixmaps, else nothing is drawn and false returned.
+template <typename F>
+bool Scale(Pixmap<F> &dst, const Rectangle &dstRc, const Pixmap<F> &src, const Rectangle &srcRc,
+    PassOrder order = PASS_AUTO)
+{
+    typedef typename F::Channel T;
+    typedef void (*Pass)(Pixmap<F> &, const Rectangle &, const Pixmap<F> &, const Rectangle &);
+    using detail::RectangleDx;
+    using detail::RectangleDy;
+
+    if (dst.p_data == NULL || src.p_data == NULL ||
+        dstRc.x1 < dstRc.x0 || dstRc.y1 < dstRc.y0 || srcRc.x1 < srcRc.x0 || srcRc.y1 < srcRc.y0)
+        return true; // nothing to draw, as ScalePixelmap32
+
+    if (!detail::RectangleInside(dstRc, dst) || !detail::RectangleInside(srcRc, src))
+        return false;
+
+    int32_t lDstDx = RectangleDx(dstRc);
+    int32_t lDstDy = RectangleDy(dstRc);
+    int32_t lSrcDx = RectangleDx(srcRc);
+    int32_t lSrcDy = RectangleDy(srcRc);
+
+    Pass pfnX = (lDstDx > lSrcDx) ? detail::ScaleUpX<F> : detail::ScaleDownX<F>;
+    Pass pfnY = (lDstDy > lSrcDy) ? detail::ScaleUpY<F> : detail::ScaleDownY<F>;
+
+    if (lDstDx == lSrcDx && lDstDy == lSrcDy)
+    {
+        for (int32_t y = 0; y < lDstDy; y++)
+            memcpy(detail::PixelPtr(dst, dstRc.x0, dstRc.y0 + y), detail::PixelPtr(src, srcRc.x0, srcRc.y0 + y),
+                (size_t)lDstDx * F::channels * sizeof(T));
+    }
+    else
+    if (lDstDy == lSrcDy)
+    {
+        pfnX(dst, dstRc, src, srcRc);
+    }
+    else
+    if (lDstDx == lSrcDx)
+    {
+        pfnY(dst, dstRc, src, srcRc);
+    }
+    else
+    {
+        bool bYX = detail::PreferYXOrder(lSrcDx, lSrcDy, lDstDx, lDstDy, order);
+        Rectangle rcTmp = {0, 0, (bYX ? lSrcDx : lDstDx) - 1, (bYX ? lDstDy : lSrcDy) - 1};
+        std::vector<T> tmpData((size_t)RectangleDx(rcTmp) * RectangleDy(rcTmp) * F::channels);
+        Pixmap<F> tmp = {(uint32_t)RectangleDx(rcTmp), (uint32_t)RectangleDy(rcTmp), &tmpData[0]};
+
+        if (bYX)
+        {
+            pfnY(tmp, rcTmp, src, srcRc);
+            pfnX(dst, dstRc, tmp, rcTmp);
+        }
+        else
+        {
+            pfnX(tmp, rcTmp, src, srcRc);
+            pfnY(dst, dstRc, tmp, rcTmp);
+        }
+    }
+    return true;
+}
+
+} // namespace pixelmap
+
+#endif // _Pixelmap32_hpp_
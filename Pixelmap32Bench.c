@@ -0,0 +1,146 @@
+/*
+  Pixelmap32Bench.c
+
+  Times ScalePixelmap32Ex with the pass order forced to XY, forced to YX and
+  left to the cost estimate, for shapes on both sides of where the choice
+  flips. Rerun it after changing the PIXELMAP32_COST_* weights in
+  Pixelmap32Tuning.h; "ok" means the estimate picked the faster order, or
+  one within 5% of it.
+
+  cc -O2 -o Pixelmap32Bench Pixelmap32Bench.c Pixelmap32.c
+  usage: Pixelmap32Bench [reps]
+
+  Copyright (C) 2004-2013 by Gary Frattarola. All rights reserved.
+
+  This code is distributed under the terms of the zlib license:
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Gary Frattarola
+  gary.frattarola@gmail.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Pixelmap32.h"
+
+typedef struct {
+    uint32_t src_dx, src_dy;
+    uint32_t dst_dx, dst_dy;
+} BenchShape;
+
+static const BenchShape g_Shapes[] = {
+    {1000, 1000, 2000, 2000}, // up/up, square
+    {1000, 1000, 4000, 1100}, // up/up, mostly wider
+    {1000, 1000, 1100, 4000}, // up/up, mostly taller
+    {1000, 2000, 3000, 1000}, // up x, down y
+    {2000, 1000, 1000, 3000}, // down x, up y
+    {4000, 1000, 1000, 1200},
+    {1000, 4000, 1200, 1000},
+    {4000, 4000, 1000, 1000}, // down/down, square
+    {4000, 4000, 3800,  500}, // down/down, mostly shorter
+    {4000, 4000,  500, 3800}, // down/down, mostly narrower
+    {4000, 3000, 4000,  750}, // vertical only
+    {4000, 3000, 1000, 3000}, // horizontal only
+};
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static double NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((ts.tv_sec * 1e3) + (ts.tv_nsec * 1e-6));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static double TimeScale(Pixelmap32 *pDstPm, Pixelmap32 *pSrcPm, uint32_t ulFlags, Pixelmap32Stats *pStats, int reps)
+{// best of reps after one untimed run, to keep first-touch page faults and other noise out
+    Rectangle rcDst = {0, 0, (int32_t)pDstPm->dx - 1, (int32_t)pDstPm->dy - 1};
+    Rectangle rcSrc = {0, 0, (int32_t)pSrcPm->dx - 1, (int32_t)pSrcPm->dy - 1};
+    double best = 0;
+    int i;
+
+    ScalePixelmap32Ex(pDstPm, &rcDst, pSrcPm, &rcSrc, ulFlags, NULL, NULL);
+
+    for (i = 0; i < reps; i++)
+    {
+        double start = NowMs();
+        ScalePixelmap32Ex(pDstPm, &rcDst, pSrcPm, &rcSrc, ulFlags, pStats, NULL);
+        double ms = NowMs() - start;
+        if (i == 0 || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    int reps = (argc > 1) ? atoi(argv[1]) : 3;
+    size_t i;
+    size_t k;
+
+    if (reps < 1)
+        reps = 1;
+
+    printf("%-24s %9s %9s %9s  pick\n", "shape", "XY ms", "YX ms", "auto ms");
+    for (i = 0; i < (sizeof(g_Shapes) / sizeof(g_Shapes[0])); i++)
+    {
+        const BenchShape *pShape = &g_Shapes[i];
+        Pixelmap32 *pSrcPm = NewPixelmap32(pShape->src_dx, pShape->src_dy);
+        Pixelmap32 *pDstPm = NewPixelmap32(pShape->dst_dx, pShape->dst_dy);
+        Pixelmap32Stats stats = {0, 0, 0, 0};
+        char szShape[32];
+
+        if (pSrcPm == NULL || pDstPm == NULL)
+        {
+            fprintf(stderr, "Pixelmap32Bench: out of memory\n");
+            return 1;
+        }
+
+        srand(1);
+        for (k = 0; k < ((size_t)pSrcPm->dx * pSrcPm->dy); k++)
+        {
+            uint32_t v = (uint32_t)rand();
+            memcpy(&pSrcPm->p_data[k], &v, sizeof(BGRA32));
+        }
+
+        double msXY = TimeScale(pDstPm, pSrcPm, PIXELMAP32_ORDER_XY, NULL, reps);
+        double msYX = TimeScale(pDstPm, pSrcPm, PIXELMAP32_ORDER_YX, NULL, reps);
+        double msAuto = TimeScale(pDstPm, pSrcPm, 0, &stats, reps);
+        int bYX = (stats.yx_scales != 0);
+        int bTwoPass = ((stats.xy_scales + stats.yx_scales) != 0);
+        double msPicked = bYX ? msYX : msXY;
+        double msOther = bYX ? msXY : msYX;
+
+        snprintf(szShape, sizeof(szShape), "%ux%u -> %ux%u",
+            pShape->src_dx, pShape->src_dy, pShape->dst_dx, pShape->dst_dy);
+        // within 5% counts as a tie; one-pass shapes have no order to pick
+        printf("%-24s %9.2f %9.2f %9.2f  %s\n", szShape, msXY, msYX, msAuto,
+            !bTwoPass ? "-- (one pass)" : (msPicked <= (msOther * 1.05)) ? (bYX ? "YX ok" : "XY ok") :
+            (bYX ? "YX SLOWER" : "XY SLOWER"));
+
+        DeletePixelmap32(&pSrcPm);
+        DeletePixelmap32(&pDstPm);
+    }
+    return 0;
+}
+
+// EOF
@@ -0,0 +1,79 @@
+/*
+  Pixelmap32Tuning.h
+
+  Constants and the pass-order choice shared by Pixelmap32.c and
+  Pixelmap32.hpp. Both must agree for Pixmap<BGRA8> to scale to exactly the
+  same pixels as ScalePixelmap32, so they live here once rather than in each
+  file. C, usable from C++.
+
+  Copyright (C) 2004-2013 by Gary Frattarola. All rights reserved.
+
+  This code is distributed under the terms of the zlib license:
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Gary Frattarola
+  gary.frattarola@gmail.com
+*/
+
+#ifndef _Pixelmap32Tuning_h_
+#define _Pixelmap32Tuning_h_
+
+#include <stdint.h>
+
+#define PIXELMAP32_DOWN_NBITS 11 // fixed-point precision of the area-averaging passes
+
+// rough per-pixel costs of the passes (about a nanosecond each), used to pick the pass order
+#define PIXELMAP32_COST_UPX_DST    5
+#define PIXELMAP32_COST_UPY_DST    4  // whole lines, copied when a line lands on a source line
+#define PIXELMAP32_COST_DOWNX_SRC  1
+#define PIXELMAP32_COST_DOWNX_DST 10
+#define PIXELMAP32_COST_DOWNY_SRC  2  // walks columns, so every sample is a strided load
+#define PIXELMAP32_COST_DOWNY_DST 18
+#define PIXELMAP32_COST_TMP        1  // allocating and first touch of the intermediate
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static inline uint64_t Pixelmap32PassCost(int bVertical, int32_t lSrcLen, int32_t lDstLen,
+    uint64_t ulSrcPixels, uint64_t ulDstPixels)
+{
+    if (lDstLen > lSrcLen)
+        return (ulDstPixels * (bVertical ? PIXELMAP32_COST_UPY_DST : PIXELMAP32_COST_UPX_DST));
+
+    if (bVertical)
+        return ((ulSrcPixels * PIXELMAP32_COST_DOWNY_SRC) + (ulDstPixels * PIXELMAP32_COST_DOWNY_DST));
+
+    return ((ulSrcPixels * PIXELMAP32_COST_DOWNX_SRC) + (ulDstPixels * PIXELMAP32_COST_DOWNX_DST));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static inline int Pixelmap32PreferYXOrder(int32_t lSrcDx, int32_t lSrcDy, int32_t lDstDx, int32_t lDstDy)
+{// XY: srcDx x srcDy -> dstDx x srcDy -> dstDx x dstDy
+ // YX: srcDx x srcDy -> srcDx x dstDy -> dstDx x dstDy
+    uint64_t ulSrc = (uint64_t)lSrcDx * lSrcDy;
+    uint64_t ulDst = (uint64_t)lDstDx * lDstDy;
+    uint64_t ulTmpXY = (uint64_t)lDstDx * lSrcDy;
+    uint64_t ulTmpYX = (uint64_t)lSrcDx * lDstDy;
+
+    uint64_t ulCostXY = Pixelmap32PassCost(0, lSrcDx, lDstDx, ulSrc, ulTmpXY) + (ulTmpXY * PIXELMAP32_COST_TMP) +
+                        Pixelmap32PassCost(!0, lSrcDy, lDstDy, ulTmpXY, ulDst);
+    uint64_t ulCostYX = Pixelmap32PassCost(!0, lSrcDy, lDstDy, ulSrc, ulTmpYX) + (ulTmpYX * PIXELMAP32_COST_TMP) +
+                        Pixelmap32PassCost(0, lSrcDx, lDstDx, ulTmpYX, ulDst);
+
+    return (ulCostYX < ulCostXY);
+}
+
+#endif // _Pixelmap32Tuning_h_
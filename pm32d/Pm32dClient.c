@@ -0,0 +1,266 @@
+/*
+  Pm32dClient.c
+
+  Copyright (C) 2004-2013 by Gary Frattarola. All rights reserved.
+
+  This code is distributed under the terms of the zlib license:
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Gary Frattarola
+  gary.frattarola@gmail.com
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Pm32dProtocol.h"
+#include "Pm32dClient.h"
+
+#define PM32D_IN_FLIGHT 4 // batches Pm32dScale sends ahead of the replies
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+Pm32dClient *Pm32dConnect(const char *pPath)
+{
+    struct sockaddr_un addr;
+    Pm32dClient *pClient;
+
+    if (pPath == NULL)
+        pPath = PM32D_SOCKET_PATH;
+    if (strlen(pPath) >= sizeof(addr.sun_path))
+        return NULL;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, pPath);
+
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+        return NULL;
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(sock);
+        return NULL;
+    }
+
+    pClient = (Pm32dClient *)calloc(1, sizeof(Pm32dClient));
+    if (pClient == NULL)
+    {
+        close(sock);
+        return NULL;
+    }
+    pClient->sock = sock;
+    return pClient;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+void Pm32dDisconnect(Pm32dClient **ppClient)
+{
+    if (ppClient != NULL && *ppClient != NULL)
+    {
+        close((*ppClient)->sock);
+        free(*ppClient);
+        *ppClient = NULL;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+Pm32dPixelmap *NewPm32dPixelmap(uint32_t dx, uint32_t dy)
+{
+    size_t size = (size_t)dx * dy * sizeof(BGRA32);
+    Pm32dPixelmap *pPm = (Pm32dPixelmap *)calloc(1, sizeof(Pm32dPixelmap));
+    if (pPm == NULL)
+        return NULL;
+
+    pPm->pm.dx = dx;
+    pPm->pm.dy = dy;
+    pPm->fd = memfd_create("Pixelmap32", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (pPm->fd < 0 || ftruncate(pPm->fd, size) != 0 ||
+        fcntl(pPm->fd, F_ADD_SEALS, F_SEAL_SHRINK) != 0) // pm32d refuses buffers that could shrink under it
+    {
+        DeletePm32dPixelmap(&pPm);
+        return NULL;
+    }
+
+    if (size > 0)
+    {
+        void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, pPm->fd, 0);
+        if (p == MAP_FAILED)
+        {
+            DeletePm32dPixelmap(&pPm);
+            return NULL;
+        }
+        pPm->pm.p_data = (BGRA32 *)p;
+    }
+    return pPm;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+void DeletePm32dPixelmap(Pm32dPixelmap **ppPm)
+{
+    if (ppPm != NULL)
+    {
+        Pm32dPixelmap *pPm = *ppPm;
+        if (pPm != NULL)
+        {
+            if (pPm->pm.p_data != NULL)
+                munmap(pPm->pm.p_data, (size_t)pPm->pm.dx * pPm->pm.dy * sizeof(BGRA32));
+            if (pPm->fd >= 0)
+                close(pPm->fd);
+            free(pPm);
+            *ppPm = NULL;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static int SendBatch(Pm32dClient *pClient, Pm32dJob *pJobs, uint32_t count)
+{
+    uint8_t msg[sizeof(Pm32dHeader) + (PM32D_MAX_BATCH * sizeof(Pm32dJobDesc))];
+    Pm32dHeader *pHdr = (Pm32dHeader *)msg;
+    Pm32dJobDesc *pDescs = (Pm32dJobDesc *)(pHdr + 1);
+    union {
+        struct cmsghdr hdr;
+        uint8_t buf[CMSG_SPACE(2 * PM32D_MAX_BATCH * sizeof(int))];
+    } ctrl;
+    int fds[2 * PM32D_MAX_BATCH];
+    uint32_t i;
+
+    pHdr->magic = PM32D_MAGIC;
+    pHdr->count = count;
+    for (i = 0; i < count; i++)
+    {
+        Pm32dJob *pJob = &pJobs[i];
+        Pm32dJobDesc *pDesc = &pDescs[i];
+
+        pDesc->dst_dx = pJob->p_dst->pm.dx;
+        pDesc->dst_dy = pJob->p_dst->pm.dy;
+        pDesc->src_dx = pJob->p_src->pm.dx;
+        pDesc->src_dy = pJob->p_src->pm.dy;
+        pDesc->dst_rc = pJob->dst_rc;
+        pDesc->src_rc = pJob->src_rc;
+        pDesc->flags = pJob->flags;
+        fds[2 * i] = pJob->p_dst->fd;
+        fds[(2 * i) + 1] = pJob->p_src->fd;
+    }
+
+    struct iovec iov = {msg, sizeof(Pm32dHeader) + (count * sizeof(Pm32dJobDesc))};
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (count > 0)
+    {
+        struct cmsghdr *pCmsg;
+        memset(&ctrl, 0, sizeof(ctrl));
+        mh.msg_control = ctrl.buf;
+        mh.msg_controllen = CMSG_SPACE(2 * count * sizeof(int));
+        pCmsg = CMSG_FIRSTHDR(&mh);
+        pCmsg->cmsg_level = SOL_SOCKET;
+        pCmsg->cmsg_type = SCM_RIGHTS;
+        pCmsg->cmsg_len = CMSG_LEN(2 * count * sizeof(int));
+        memcpy(CMSG_DATA(pCmsg), fds, 2 * count * sizeof(int));
+    }
+
+    return (sendmsg(pClient->sock, &mh, MSG_NOSIGNAL) == (ssize_t)iov.iov_len);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static int RecvBatch(Pm32dClient *pClient, Pm32dJob *pJobs, uint32_t count)
+{
+    uint8_t reply[sizeof(Pm32dHeader) + (PM32D_MAX_BATCH * sizeof(Pm32dJobResult))];
+    Pm32dHeader *pHdr = (Pm32dHeader *)reply;
+    Pm32dJobResult *pResults = (Pm32dJobResult *)(pHdr + 1);
+    uint32_t i;
+
+    ssize_t len = recv(pClient->sock, reply, sizeof(reply), 0);
+    if (len < (ssize_t)sizeof(Pm32dHeader) || pHdr->magic != PM32D_MAGIC || pHdr->count != count ||
+        len != (ssize_t)(sizeof(Pm32dHeader) + (count * sizeof(Pm32dJobResult))))
+        return 0;
+
+    for (i = 0; i < count; i++)
+    {
+        pJobs[i].result = pResults[i].result;
+        pJobs[i].queue_ns = pResults[i].queue_ns;
+        pJobs[i].service_ns = pResults[i].service_ns;
+    }
+    return !0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+int Pm32dSubmit(Pm32dClient *pClient, Pm32dJob *pJobs, uint32_t count)
+{
+    while (count > 0)
+    {
+        uint32_t n = (count > PM32D_MAX_BATCH) ? PM32D_MAX_BATCH : count;
+        if (!SendBatch(pClient, pJobs, n))
+            return 0;
+        pJobs += n;
+        count -= n;
+    }
+    return !0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+int Pm32dWait(Pm32dClient *pClient, Pm32dJob *pJobs, uint32_t count)
+{
+    while (count > 0)
+    {
+        uint32_t n = (count > PM32D_MAX_BATCH) ? PM32D_MAX_BATCH : count;
+        if (!RecvBatch(pClient, pJobs, n))
+            return 0;
+        pJobs += n;
+        count -= n;
+    }
+    return !0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+int Pm32dScale(Pm32dClient *pClient, Pm32dJob *pJobs, uint32_t count)
+{// keeps a few batches in flight so the daemon has the next one as soon as it replies
+    uint32_t sent = 0;
+    uint32_t done = 0;
+
+    while (done < count)
+    {
+        if (sent < count && (sent - done) < (PM32D_MAX_BATCH * PM32D_IN_FLIGHT))
+        {
+            uint32_t n = ((count - sent) > PM32D_MAX_BATCH) ? PM32D_MAX_BATCH : (count - sent);
+            if (!SendBatch(pClient, &pJobs[sent], n))
+                return 0;
+            sent += n;
+        }
+        else
+        {
+            uint32_t n = ((sent - done) > PM32D_MAX_BATCH) ? PM32D_MAX_BATCH : (sent - done);
+            if (!RecvBatch(pClient, &pJobs[done], n))
+                return 0;
+            done += n;
+        }
+    }
+    return !0;
+}
+
+// EOF
@@ -0,0 +1,86 @@
+/*
+  Pm32dClient.h
+
+  Client side of pm32d: memfd-backed pixelmaps and batched scale jobs.
+
+  Copyright (C) 2004-2013 by Gary Frattarola. All rights reserved.
+
+  This code is distributed under the terms of the zlib license:
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Gary Frattarola
+  gary.frattarola@gmail.com
+*/
+
+#ifndef _Pm32dClient_h_
+#define _Pm32dClient_h_
+
+#include <stdint.h>
+
+#include "../Pixelmap32.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	Pixelmap32 pm; // p_data is a shared mapping of fd, usable like any Pixelmap32
+	int fd;
+} Pm32dPixelmap;
+
+typedef struct {
+	Pm32dPixelmap *p_dst;
+	Rectangle dst_rc;    // dst_rc and src_rc must lie inside their pixmaps, pm32d does not clip
+	Pm32dPixelmap *p_src;
+	Rectangle src_rc;
+	uint32_t flags;      // ScalePixelmap32Ex flags; the daemon ignores PIXELMAP32_ORDER_*
+
+	// filled in by Pm32dWait
+	int32_t result;      // ScalePixelmap32Ex result, -1 if the daemon rejected the job
+	uint64_t queue_ns;   // time the job waited for a worker
+	uint64_t service_ns; // time the worker spent scaling
+} Pm32dJob;
+
+typedef struct {
+	int sock;
+} Pm32dClient;
+
+// pPath may be NULL for PM32D_SOCKET_PATH
+Pm32dClient *Pm32dConnect(const char *pPath);
+
+void Pm32dDisconnect(Pm32dClient **ppClient);
+
+Pm32dPixelmap *NewPm32dPixelmap(uint32_t dx, uint32_t dy);
+
+void DeletePm32dPixelmap(Pm32dPixelmap **ppPm);
+
+// Submit sends the jobs (split into batches of PM32D_MAX_BATCH); Wait collects the
+// results of the same jobs. Several Submits may be outstanding; Wait in the same order.
+// Replies queue in the socket until waited for, so do not submit thousands of jobs ahead.
+int Pm32dSubmit(Pm32dClient *pClient, Pm32dJob *pJobs, uint32_t count);
+
+int Pm32dWait(Pm32dClient *pClient, Pm32dJob *pJobs, uint32_t count);
+
+// Submit + Wait, with a bounded number of batches in flight
+int Pm32dScale(Pm32dClient *pClient, Pm32dJob *pJobs, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _Pm32dClient_h_
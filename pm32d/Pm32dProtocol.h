@@ -0,0 +1,72 @@
+/*
+  Pm32dProtocol.h
+
+  Wire format between pm32d and Pm32dClient.
+
+  Copyright (C) 2004-2013 by Gary Frattarola. All rights reserved.
+
+  This code is distributed under the terms of the zlib license:
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Gary Frattarola
+  gary.frattarola@gmail.com
+*/
+
+#ifndef _Pm32dProtocol_h_
+#define _Pm32dProtocol_h_
+
+#include <stdint.h>
+
+#include "../Pixelmap32.h"
+
+// One SOCK_SEQPACKET message per batch, each way:
+//   request: Pm32dHeader + count * Pm32dJobDesc, with 2 * count memfds attached
+//            (SCM_RIGHTS, dst then src for each job), each sealed with F_SEAL_SHRINK
+//   reply:   Pm32dHeader + count * Pm32dJobResult, in job order
+// Batches on one connection are answered in the order they were sent.
+
+#define PM32D_SOCKET_DIR  "/run/pm32d" // not world-writable, so no other user can take the name
+#define PM32D_SOCKET_PATH PM32D_SOCKET_DIR "/pm32d.sock"
+#define PM32D_MAGIC       0x64323370 // "p32d"
+#define PM32D_MAX_BATCH   64         // 2 fds per job, kernel limit is 253 per message
+#define PM32D_MAX_SIDE    (1 << 20)  // widest / tallest pixmap served; below 2^32 pixels in all
+
+#pragma pack(push, 1)
+
+typedef struct {
+	uint32_t magic;
+	uint32_t count;
+} Pm32dHeader;
+
+typedef struct {
+	uint32_t dst_dx, dst_dy; // shape of the pixelmap in the dst memfd
+	uint32_t src_dx, src_dy; // shape of the pixelmap in the src memfd
+	Rectangle dst_rc, src_rc; // must lie inside their pixmaps, pm32d does not clip
+	uint32_t flags;          // ScalePixelmap32Ex flags, PIXELMAP32_ORDER_* ignored
+} Pm32dJobDesc;
+
+typedef struct {
+	int32_t result;          // ScalePixelmap32Ex result, -1 if the job was rejected: a rectangle outside its
+	                         // pixmap, a pixmap too large, or buffers not mappable or not sealed
+	uint64_t queue_ns;       // batch received to a worker starting the job
+	uint64_t service_ns;     // time spent scaling
+} Pm32dJobResult;
+
+#pragma pack(pop)
+
+#endif // _Pm32dProtocol_h_
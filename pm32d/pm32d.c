@@ -0,0 +1,411 @@
+/*
+  pm32d.c
+
+  Local scaling daemon: serves ScalePixelmap32Ex over a Unix domain socket
+  to every process on the host from one worker pool. Pixels are passed as
+  memfds and mapped, never copied.
+
+  usage: pm32d [-s socket_path] [-m socket_mode] [-j workers]
+
+  Copyright (C) 2004-2013 by Gary Frattarola. All rights reserved.
+
+  This code is distributed under the terms of the zlib license:
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Gary Frattarola
+  gary.frattarola@gmail.com
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "Pm32dProtocol.h"
+
+struct Batch;
+
+typedef struct Job {
+    struct Job *p_next;
+    struct Batch *p_batch;
+    Pm32dJobDesc *p_desc;
+    Pm32dJobResult *p_result;
+    Pixelmap32 dst_pm, src_pm;
+} Job;
+
+typedef struct Batch {
+    pthread_mutex_t mutex;
+    pthread_cond_t done;
+    uint32_t pending;
+    uint64_t received_ns;
+} Batch;
+
+// the one queue all connections feed and all workers drain
+static pthread_mutex_t g_QueueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_QueueCond = PTHREAD_COND_INITIALIZER;
+static Job *g_pQueueHead = NULL;
+static Job *g_pQueueTail = NULL;
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000u) + ts.tv_nsec;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void PushJob(Job *pJob)
+{
+    pJob->p_next = NULL;
+    pthread_mutex_lock(&g_QueueMutex);
+    if (g_pQueueTail != NULL)
+        g_pQueueTail->p_next = pJob;
+    else
+        g_pQueueHead = pJob;
+    g_pQueueTail = pJob;
+    pthread_cond_signal(&g_QueueCond);
+    pthread_mutex_unlock(&g_QueueMutex);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static Job *PopJob(void)
+{
+    Job *pJob;
+    pthread_mutex_lock(&g_QueueMutex);
+    while (g_pQueueHead == NULL)
+        pthread_cond_wait(&g_QueueCond, &g_QueueMutex);
+    pJob = g_pQueueHead;
+    g_pQueueHead = pJob->p_next;
+    if (g_pQueueHead == NULL)
+        g_pQueueTail = NULL;
+    pthread_mutex_unlock(&g_QueueMutex);
+    return pJob;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void *WorkerMain(void *pArg)
+{
+    Pixelmap32 *pScratchPm = NewPixelmap32(0, 0); // intermediate, reused for every job on this worker
+    (void)pArg;
+
+    for (;;)
+    {
+        Job *pJob = PopJob();
+        Batch *pBatch = pJob->p_batch;
+        uint64_t ulStart = NowNs();
+
+        pJob->p_result->result = ScalePixelmap32Ex(&pJob->dst_pm, &pJob->p_desc->dst_rc,
+            &pJob->src_pm, &pJob->p_desc->src_rc, pJob->p_desc->flags, NULL, pScratchPm);
+        pJob->p_result->queue_ns = ulStart - pBatch->received_ns;
+        pJob->p_result->service_ns = NowNs() - ulStart;
+
+        pthread_mutex_lock(&pBatch->mutex);
+        if (--pBatch->pending == 0)
+            pthread_cond_signal(&pBatch->done);
+        pthread_mutex_unlock(&pBatch->mutex);
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static int MapPixelmap(Pixelmap32 *pPm, int fd, uint32_t dx, uint32_t dy, int prot)
+{
+    struct stat st;
+    size_t size = (size_t)dx * dy * sizeof(BGRA32);
+
+    pPm->dx = dx;
+    pPm->dy = dy;
+    pPm->p_data = NULL;
+    if (size == 0)
+        return !0; // empty, ScalePixelmap32Ex treats it as such
+
+    // without F_SEAL_SHRINK the client could truncate the memfd mid-job and SIGBUS the worker
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals == -1 || !(seals & F_SEAL_SHRINK))
+        return 0;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < size)
+        return 0;
+
+    void *p = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        return 0;
+    pPm->p_data = (BGRA32 *)p;
+    return !0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void UnmapPixelmap(Pixelmap32 *pPm)
+{
+    if (pPm->p_data != NULL)
+        munmap(pPm->p_data, (size_t)pPm->dx * pPm->dy * sizeof(BGRA32));
+    pPm->p_data = NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static int RectangleFits(const Rectangle *pRc, uint32_t dx, uint32_t dy)
+{// Client rectangles must lie inside their pixmaps, and the pixmaps be small enough for the
+ // library's 32-bit offsets and fixed-point increments; clipping arithmetic on arbitrary
+ // coordinates overflows, so it is never reached from here.
+    if (dx > PM32D_MAX_SIDE || dy > PM32D_MAX_SIDE || ((uint64_t)dx * dy) > UINT32_MAX)
+        return 0;
+    return (pRc->x0 >= 0 && pRc->x0 <= pRc->x1 && (uint32_t)pRc->x1 < dx &&
+            pRc->y0 >= 0 && pRc->y0 <= pRc->y1 && (uint32_t)pRc->y1 < dy);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void ServeBatch(int sock, uint8_t *pMsg, ssize_t msgLen, int *pFds, uint32_t fdCount)
+{
+    static const Pm32dHeader hdrErr = {PM32D_MAGIC, 0};
+    Pm32dHeader *pHdr = (Pm32dHeader *)pMsg;
+    Pm32dJobDesc *pDescs = (Pm32dJobDesc *)(pHdr + 1);
+    uint32_t count = pHdr->count;
+    uint32_t i;
+
+    if (msgLen < (ssize_t)sizeof(Pm32dHeader) || pHdr->magic != PM32D_MAGIC ||
+        count > PM32D_MAX_BATCH || fdCount != (2 * count) ||
+        msgLen != (ssize_t)(sizeof(Pm32dHeader) + (count * sizeof(Pm32dJobDesc))))
+    {// malformed: answer with an empty batch so the client does not hang
+        send(sock, &hdrErr, sizeof(hdrErr), MSG_NOSIGNAL);
+        return;
+    }
+
+    uint8_t reply[sizeof(Pm32dHeader) + (PM32D_MAX_BATCH * sizeof(Pm32dJobResult))];
+    Pm32dHeader *pReplyHdr = (Pm32dHeader *)reply;
+    Pm32dJobResult *pResults = (Pm32dJobResult *)(pReplyHdr + 1);
+    Job jobs[PM32D_MAX_BATCH];
+    Batch batch;
+
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_cond_init(&batch.done, NULL);
+    batch.pending = 0;
+    batch.received_ns = NowNs();
+
+    for (i = 0; i < count; i++)
+    {
+        Job *pJob = &jobs[i];
+        Pm32dJobDesc *pDesc = &pDescs[i];
+
+        // forcing the pass order could make this worker allocate an intermediate far larger than
+        // either buffer the client passed; the automatic order keeps it in proportion to them
+        pDesc->flags &= ~(PIXELMAP32_ORDER_XY | PIXELMAP32_ORDER_YX);
+
+        memset(&pResults[i], 0, sizeof(Pm32dJobResult));
+        memset(&pJob->dst_pm, 0, sizeof(Pixelmap32));
+        memset(&pJob->src_pm, 0, sizeof(Pixelmap32));
+        pJob->p_batch = &batch;
+        pJob->p_desc = pDesc;
+        pJob->p_result = &pResults[i];
+
+        if (!RectangleFits(&pDesc->dst_rc, pDesc->dst_dx, pDesc->dst_dy) ||
+            !RectangleFits(&pDesc->src_rc, pDesc->src_dx, pDesc->src_dy) ||
+            !MapPixelmap(&pJob->dst_pm, pFds[2 * i], pDesc->dst_dx, pDesc->dst_dy, PROT_READ | PROT_WRITE) ||
+            !MapPixelmap(&pJob->src_pm, pFds[(2 * i) + 1], pDesc->src_dx, pDesc->src_dy, PROT_READ))
+        {
+            pResults[i].result = -1;
+            continue;
+        }
+        batch.pending++;
+    }
+
+    // only queue once pending is final, so the count cannot hit zero early
+    for (i = 0; i < count; i++)
+        if (pResults[i].result != -1)
+            PushJob(&jobs[i]);
+
+    pthread_mutex_lock(&batch.mutex);
+    while (batch.pending != 0)
+        pthread_cond_wait(&batch.done, &batch.mutex);
+    pthread_mutex_unlock(&batch.mutex);
+
+    for (i = 0; i < count; i++)
+    {
+        UnmapPixelmap(&jobs[i].dst_pm);
+        UnmapPixelmap(&jobs[i].src_pm);
+    }
+    pthread_cond_destroy(&batch.done);
+    pthread_mutex_destroy(&batch.mutex);
+
+    pReplyHdr->magic = PM32D_MAGIC;
+    pReplyHdr->count = count;
+    send(sock, reply, sizeof(Pm32dHeader) + (count * sizeof(Pm32dJobResult)), MSG_NOSIGNAL);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+static void *ConnectionMain(void *pArg)
+{
+    int sock = (int)(intptr_t)pArg;
+    uint8_t msg[sizeof(Pm32dHeader) + (PM32D_MAX_BATCH * sizeof(Pm32dJobDesc))];
+    union {
+        struct cmsghdr hdr;
+        uint8_t buf[CMSG_SPACE(2 * PM32D_MAX_BATCH * sizeof(int))];
+    } ctrl;
+
+    for (;;)
+    {
+        struct iovec iov = {msg, sizeof(msg)};
+        struct msghdr mh;
+        struct cmsghdr *pCmsg;
+        int fds[2 * PM32D_MAX_BATCH];
+        uint32_t fdCount = 0;
+        uint32_t i;
+
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        mh.msg_control = ctrl.buf;
+        mh.msg_controllen = sizeof(ctrl.buf);
+
+        ssize_t msgLen = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+        if (msgLen <= 0)
+            break;
+
+        for (pCmsg = CMSG_FIRSTHDR(&mh); pCmsg != NULL; pCmsg = CMSG_NXTHDR(&mh, pCmsg))
+        {
+            if (pCmsg->cmsg_level == SOL_SOCKET && pCmsg->cmsg_type == SCM_RIGHTS)
+            {
+                uint32_t n = (pCmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                if (n > (2 * PM32D_MAX_BATCH) - fdCount)
+                    n = (2 * PM32D_MAX_BATCH) - fdCount;
+                memcpy(&fds[fdCount], CMSG_DATA(pCmsg), n * sizeof(int));
+                fdCount += n;
+            }
+        }
+
+        if (mh.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+            msgLen = 0; // rejected as malformed
+        ServeBatch(sock, msg, msgLen, fds, fdCount);
+
+        for (i = 0; i < fdCount; i++)
+            close(fds[i]);
+    }
+
+    close(sock);
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    const char *pPath = PM32D_SOCKET_PATH;
+    mode_t mode = 0666; // any local user may connect; all they can reach is their own buffers
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    struct sockaddr_un addr;
+    struct stat st;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int opt;
+    long i;
+
+    while ((opt = getopt(argc, argv, "s:m:j:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            pPath = optarg;
+            break;
+        case 'm':
+            mode = (mode_t)strtol(optarg, NULL, 8) & 0777;
+            break;
+        case 'j':
+            workers = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s socket_path] [-m socket_mode] [-j workers]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (workers < 1)
+        workers = 1;
+
+    if (strlen(pPath) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "pm32d: socket path too long\n");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+    {
+        perror("pm32d: socket");
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, pPath);
+    if (strcmp(pPath, PM32D_SOCKET_PATH) == 0 && mkdir(PM32D_SOCKET_DIR, 0755) != 0 && errno != EEXIST)
+    {
+        perror("pm32d: " PM32D_SOCKET_DIR);
+        return 1;
+    }
+    if (lstat(pPath, &st) == 0)
+    {// a stale socket from an earlier run; never remove anything else -s happens to name
+        if (!S_ISSOCK(st.st_mode))
+        {
+            fprintf(stderr, "pm32d: %s exists and is not a socket\n", pPath);
+            return 1;
+        }
+        unlink(pPath);
+    }
+    // connecting needs write permission on the socket, so its mode cannot be left to the umask
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || chmod(pPath, mode) != 0 ||
+        listen(listener, 64) != 0)
+    {
+        perror("pm32d: bind");
+        return 1;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    for (i = 0; i < workers; i++)
+    {
+        if (pthread_create(&thread, &attr, WorkerMain, NULL) != 0)
+        {
+            perror("pm32d: pthread_create");
+            return 1;
+        }
+    }
+
+    for (;;)
+    {
+        int sock = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if (sock < 0)
+            continue;
+        if (pthread_create(&thread, &attr, ConnectionMain, (void *)(intptr_t)sock) != 0)
+            close(sock);
+    }
+
+    return 0;
+}
+
+// EOF